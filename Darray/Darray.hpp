@@ -5,6 +5,8 @@
 #include <cstddef>
 #include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
@@ -23,6 +25,9 @@ template <typename T, int... Dims>
 class Darray_base {
  public:
   using dimension_type = size_t;
+  /** an std::array with as many elements, the elements themselves are kept
+   * in a plain buffer addressed by pointer iterators
+   */
   using storage_type =
       std::array<T, get_prod<dimension_type, sizeof...(Dims), Dims...>::answer>;
   using value_type = typename storage_type::value_type;
@@ -32,10 +37,10 @@ class Darray_base {
   using pointer = typename storage_type::pointer;
   using const_pointer = typename storage_type::const_pointer;
   using difference_type = typename storage_type::difference_type;
-  using iterator = typename storage_type::iterator;
-  using const_iterator = typename storage_type::const_iterator;
-  using reverse_iterator = typename storage_type::reverse_iterator;
-  using const_reverse_iterator = typename storage_type::const_reverse_iterator;
+  using iterator = pointer;
+  using const_iterator = const_pointer;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
   /** virtual destructor*/
   virtual ~Darray_base() {}
   /** an at function, may throw
@@ -184,10 +189,23 @@ struct sub_itr<Farr, T, 1, val_, Dims...> {
   using itr_type = Darray_slice<Farr, T, Dims...>;
 };
 
+/** tag type selecting the constructor of Darray which leaves the elements
+ * default-initialized, i.e. uninitialized for trivial types.
+ */
+struct for_overwrite_t {
+  explicit for_overwrite_t() = default;
+};
+/** tag object of for_overwrite_t*/
+constexpr for_overwrite_t for_overwrite{};
+
 /**
  * a class public inherited from Darray_base, which has value-like
  * behaviours.
  *
+ * every element is constructed exactly once. Darray() and
+ * Darray(for_overwrite) default-initialize, leaving trivial types
+ * uninitialized; elements not covered by an initializer list or a range are
+ * value-initialized.
  * @see Darray_base
  */
 template <typename T, int... Dims>
@@ -211,41 +229,113 @@ class Darray : public Darray_base<T, Dims...> {
   using pointer = typename storage_type::pointer;
   using const_pointer = typename storage_type::const_pointer;
   using difference_type = typename storage_type::difference_type;
-  using iterator = typename storage_type::iterator;
-  using const_iterator = typename storage_type::const_iterator;
-  using reverse_iterator = typename storage_type::reverse_iterator;
-  using const_reverse_iterator = typename storage_type::const_reverse_iterator;
+  using iterator = typename parent_type::iterator;
+  using const_iterator = typename parent_type::const_iterator;
+  using reverse_iterator = typename parent_type::reverse_iterator;
+  using const_reverse_iterator = typename parent_type::const_reverse_iterator;
 
  protected:
   using count_type = unsigned int;
   /** reference count provided for Darray_slice type*/
-  count_type *cptr;
+  count_type *cptr = nullptr;
 
  public:
   /** conversion constructor
-   * provide the ability to be list-initialized
+   * provide the ability to be list-initialized, elements without initializer
+   * are value-initialized
    *
    * @param list_ a std::initializer_list<T> object
    * @excepion std::bad_alloc
+   * @excepion std::length_error
    */
-  Darray(std::initializer_list<T> list_)
-      : arr_ptr(new storage_type), cptr(new count_type(1)) {
+  Darray(std::initializer_list<T> list_) {
     this->test_range(list_.size());
-    std::copy(list_.begin(), list_.end(), arr_ptr->begin());
+    init_storage([&](pointer first_) {
+      construct_from(first_, list_.begin(), list_.end());
+    });
   }
   /** defualt constructor
    *
-   * the elements in the array is defualt constructed
+   * the elements in the array is default-initialized, so trivial types are
+   * left uninitialized
+   * @excepion std::bad_alloc
+   */
+  Darray() : Darray(for_overwrite) {}
+  /** constructor leaves the elements default-initialized
+   *
+   * the same as the default constructor, spelling out that the elements are
+   * expected to be overwritten before read
+   * @excepion std::bad_alloc
+   */
+  explicit Darray(for_overwrite_t) {
+    init_storage([this](pointer first_) {
+      construct_default(first_, std::is_trivially_default_constructible<T>());
+    });
+  }
+  /** fill constructor
+   *
+   * @param value_ every element is copy constructed from it
+   * @excepion std::bad_alloc
+   */
+  explicit Darray(const T &value_) {
+    init_storage([&](pointer first_) {
+      std::uninitialized_fill(first_, first_ + this->size(), value_);
+    });
+  }
+  /** generator constructor
+   *
+   * chosen whenever gen_(i) is well-formed, even if Generator is also
+   * convertible to T (e.g. a captureless lambda and T = bool)
+   * @param gen_ a callable object, the element at index i is constructed from
+   * gen_(i)
+   * @excepion std::bad_alloc
+   */
+  template <typename Generator,
+            typename = typename std::enable_if<
+                !std::is_same<typename std::decay<Generator>::type,
+                              T>::value &&
+                std::is_convertible<decltype(std::declval<Generator &>()(
+                                        std::declval<size_type>())),
+                                    T>::value>::type>
+  explicit Darray(Generator gen_) {
+    init_storage([&](pointer first_) { construct_generate(first_, gen_); });
+  }
+  /** range constructor, elements not covered by the range are
+   * value-initialized
+   *
+   * pass std::move_iterator to move the elements in
+   * @param first_ iterator to the first element of the range
+   * @param last_ iterator to the end of the range
+   * @excepion std::bad_alloc
+   * @excepion std::length_error
+   */
+  template <typename InputIt, typename = typename std::iterator_traits<
+                                  InputIt>::iterator_category>
+  Darray(InputIt first_, InputIt last_) {
+    init_storage(
+        [&](pointer dest_) { construct_from(dest_, first_, last_); });
+  }
+  /** constructor copies elements from an std::array of the same size
+   *
    * @excepion std::bad_alloc
    */
-  Darray() : arr_ptr(new storage_type), cptr(new count_type(1)) {}
+  explicit Darray(const storage_type &arr_)
+      : Darray(arr_.begin(), arr_.end()) {}
+  /** constructor moves elements from an std::array of the same size
+   *
+   * @excepion std::bad_alloc
+   */
+  explicit Darray(storage_type &&arr_)
+      : Darray(std::make_move_iterator(arr_.begin()),
+               std::make_move_iterator(arr_.end())) {}
   /** copy constructor
    *
    * @exception std::bad_alloc
    */
-  Darray(const Darray &arr)
-      : arr_ptr(new storage_type), cptr(new count_type(1)) {
-    std::copy(arr.cbegin(), arr.cend(), arr_ptr->begin());
+  Darray(const Darray &arr) {
+    init_storage([&](pointer first_) {
+      std::uninitialized_copy(arr.cbegin(), arr.cend(), first_);
+    });
   }
   /** move constructor*/
   Darray(Darray &&arr) noexcept {
@@ -255,58 +345,164 @@ class Darray : public Darray_base<T, Dims...> {
     arr.cptr = nullptr;
   }
   /** copy&&move- assignment operator*/
-  Darray &operator=(Darray arr) { ccs::swap(*this, arr); }
+  Darray &operator=(Darray arr) {
+    ccs::swap(*this, arr);
+    return *this;
+  }
   virtual ~Darray() {
-    delete arr_ptr;
-    if (--*cptr == 0) delete cptr;
+    release_storage();
+    if (cptr && --*cptr == 0) delete cptr;
   };
   void swap(Darray &arr) noexcept { ccs::swap(*this, arr); }
   /** override Darray_base::operator[]*/
   virtual reference operator[](size_type i_) noexcept override {
-    return (*arr_ptr)[i_];
+    return arr_ptr[i_];
   };
   /** override Darray_base::operator[]*/
   virtual const_reference operator[](size_type i_) const noexcept override {
-    return (*arr_ptr)[i_];
+    return arr_ptr[i_];
   };
 
-  virtual iterator begin() noexcept override { return arr_ptr->begin(); }
-  virtual const_iterator cbegin() const noexcept override {
-    return arr_ptr->cbegin();
-  }
-  virtual iterator end() noexcept override { return arr_ptr->end(); }
+  virtual iterator begin() noexcept override { return arr_ptr; }
+  virtual const_iterator cbegin() const noexcept override { return arr_ptr; }
+  virtual iterator end() noexcept override { return arr_ptr + this->size(); }
   virtual const_iterator cend() const noexcept override {
-    return arr_ptr->cend();
+    return arr_ptr + this->size();
   }
   virtual reverse_iterator rbegin() noexcept override {
-    return arr_ptr->rbegin();
+    return reverse_iterator(end());
   }
   virtual const_reverse_iterator crbegin() const noexcept override {
-    return arr_ptr->crbegin();
+    return const_reverse_iterator(cend());
+  }
+  virtual reverse_iterator rend() noexcept override {
+    return reverse_iterator(begin());
   }
-  virtual reverse_iterator rend() noexcept override { return arr_ptr->rend(); }
   virtual const_reverse_iterator crend() const noexcept override {
-    return arr_ptr->crend();
+    return const_reverse_iterator(cbegin());
   }
 
-  slice_type sbegin() { return slice_type(arr_ptr->begin(), cptr); }
-  const_slice_type csbegin() const {
-    return slice_type(arr_ptr->begin(), cptr);
+  slice_type sbegin() { return slice_type(arr_ptr, cptr); }
+  const_slice_type csbegin() const { return slice_type(arr_ptr, cptr); }
+  slice_type send() { return slice_type(arr_ptr + this->size(), cptr); }
+  const_slice_type csend() const {
+    return slice_type(arr_ptr + this->size(), cptr);
   }
-  slice_type send() { return slice_type(arr_ptr->end(), cptr); }
-  const_slice_type csend() const { return slice_type(arr_ptr->end(), cptr); }
 
  protected:
-  /** a pointer point to storage memory*/
-  storage_type *arr_ptr;
+  /** a pointer point to the first element of the storage memory*/
+  pointer arr_ptr = nullptr;
+
+  /** allocate the storage without constructing any element, then let
+   * construct_ build all of them in place
+   *
+   * construct_ must either construct every element or throw with nothing left
+   * constructed.
+   * @param construct_ a callable object taking a pointer to the first element
+   * @excepion std::bad_alloc
+   */
+  template <typename Construct>
+  void init_storage(Construct construct_) {
+    std::unique_ptr<count_type> count(new count_type(1));
+    pointer raw = std::allocator<T>().allocate(this->size());
+    try {
+      construct_(raw);
+    } catch (...) {
+      std::allocator<T>().deallocate(raw, this->size());
+      throw;
+    }
+    arr_ptr = raw;
+    cptr = count.release();
+  }
+  /** destroy all elements and free the storage*/
+  void release_storage() noexcept {
+    if (arr_ptr == nullptr) return;
+    destroy_range(arr_ptr, arr_ptr + this->size());
+    std::allocator<T>().deallocate(arr_ptr, this->size());
+    arr_ptr = nullptr;
+  }
+  static void destroy_range(pointer first_, pointer last_) noexcept {
+    if (std::is_trivially_destructible<T>::value) return;
+    for (; first_ != last_; ++first_) first_->~T();
+  }
+  /** trivial types need no work to be default-initialized*/
+  void construct_default(pointer, std::true_type) noexcept {}
+  void construct_default(pointer first_, std::false_type) {
+    pointer cur = first_;
+    try {
+      for (; cur != first_ + this->size(); ++cur)
+        ::new (static_cast<void *>(cur)) T;
+    } catch (...) {
+      destroy_range(first_, cur);
+      throw;
+    }
+  }
+  template <typename Generator>
+  void construct_generate(pointer first_, Generator &gen_) {
+    pointer cur = first_;
+    try {
+      for (size_type i = 0; i != this->size(); ++i, ++cur)
+        ::new (static_cast<void *>(cur)) T(gen_(i));
+    } catch (...) {
+      destroy_range(first_, cur);
+      throw;
+    }
+  }
+  template <typename InputIt>
+  void construct_from(pointer first_, InputIt begin_, InputIt end_) {
+    construct_from(first_, begin_, end_,
+                   typename std::iterator_traits<InputIt>::iterator_category());
+  }
+  /** single pass version, the length is checked while constructing*/
+  template <typename InputIt>
+  void construct_from(pointer first_, InputIt begin_, InputIt end_,
+                      std::input_iterator_tag) {
+    pointer cur = first_;
+    try {
+      for (; begin_ != end_; ++begin_, ++cur) {
+        if (cur == first_ + this->size()) throw this->LENGTH_ERROR;
+        ::new (static_cast<void *>(cur)) T(*begin_);
+      }
+      construct_value(first_, cur);
+    } catch (...) {
+      destroy_range(first_, cur);
+      throw;
+    }
+  }
+  /** multi pass version, the length is checked before constructing*/
+  template <typename ForwardIt>
+  void construct_from(pointer first_, ForwardIt begin_, ForwardIt end_,
+                      std::forward_iterator_tag) {
+    this->test_range(std::distance(begin_, end_));
+    pointer cur = std::uninitialized_copy(begin_, end_, first_);
+    try {
+      construct_value(first_, cur);
+    } catch (...) {
+      destroy_range(first_, cur);
+      throw;
+    }
+  }
+  /** value-initialize [cur_, end of storage), nothing of them is left
+   * constructed on failure
+   */
+  void construct_value(pointer first_, pointer cur_) {
+    pointer start = cur_;
+    try {
+      for (; cur_ != first_ + this->size(); ++cur_)
+        ::new (static_cast<void *>(cur_)) T();
+    } catch (...) {
+      destroy_range(start, cur_);
+      throw;
+    }
+  }
 
   /** override pure virtual function in Darray_base*/
   virtual reference do_at(size_type pos_) noexcept override {
-    return arr_ptr->at(pos_);
+    return arr_ptr[pos_];
   }
   /** override pure virtual function in Darray_base*/
   virtual const_reference do_at(size_type pos_) const noexcept override {
-    return arr_ptr->at(pos_);
+    return arr_ptr[pos_];
   }
 };
 
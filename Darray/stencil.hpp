@@ -0,0 +1,455 @@
+#ifndef STENCIL
+#define STENCIL
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Darray.hpp"
+
+/** hint the compiler that the loop carries no dependency between iterations,
+ * so that the inner axis can be vectorized without runtime alias checks.
+ * undefined again at the end of this file
+ */
+#if defined(__clang__)
+#define CCS_STENCIL_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define CCS_STENCIL_IVDEP _Pragma("GCC ivdep")
+#else
+#define CCS_STENCIL_IVDEP
+#endif
+
+namespace ccs {
+namespace stencil {
+/**
+ * one point of a neighborhood, as offsets relative to the updated cell.
+ *
+ * the offsets are given in the same order as the dimensions of the Darray,
+ * i.e. the first one is along the contiguous axis.
+ * @param Offs offset along each dimension
+ */
+template <int... Offs>
+struct point {
+  static constexpr std::size_t dimension = sizeof...(Offs);
+  static constexpr std::array<int, dimension> offsets() noexcept {
+    return {{Offs...}};
+  }
+};
+
+/**
+ * a compile-time neighborhood description, composed of several points.
+ *
+ * the kernel receives the values of the points in the order they are listed.
+ * @param Points template parameter pack of point
+ */
+template <typename Point, typename... Points>
+struct neighborhood {
+  static constexpr std::size_t size = 1 + sizeof...(Points);
+  static constexpr std::size_t dimension = Point::dimension;
+  using table_type =
+      std::array<std::array<int, dimension>, 1 + sizeof...(Points)>;
+
+  /** offsets of every point, indexed by [point][dimension]*/
+  static constexpr table_type table() noexcept {
+    return {{Point::offsets(), Points::offsets()...}};
+  }
+  /** the smallest offset along dimension d_, never greater than 0*/
+  static constexpr int min_offset(std::size_t d_) noexcept {
+    int ans = 0;
+    for (std::size_t k = 0; k != size; ++k) {
+      if (table()[k][d_] < ans) ans = table()[k][d_];
+    }
+    return ans;
+  }
+  /** the largest offset along dimension d_, never less than 0*/
+  static constexpr int max_offset(std::size_t d_) noexcept {
+    int ans = 0;
+    for (std::size_t k = 0; k != size; ++k) {
+      if (table()[k][d_] > ans) ans = table()[k][d_];
+    }
+    return ans;
+  }
+
+ private:
+  template <bool... Bs>
+  struct all_of : std::is_same<all_of<Bs...>, all_of<(Bs || true)...>> {};
+  static_assert(all_of<(Points::dimension == dimension)...>::value,
+                "ERROR: points of a neighborhood differ in dimension");
+};
+
+/** the cell itself and its 4 direct neighbours on a 2D grid*/
+using cross_2d = neighborhood<point<0, 0>, point<-1, 0>, point<1, 0>,
+                              point<0, -1>, point<0, 1>>;
+/** the cell itself and its 6 direct neighbours on a 3D grid*/
+using cross_3d =
+    neighborhood<point<0, 0, 0>, point<-1, 0, 0>, point<1, 0, 0>,
+                 point<0, -1, 0>, point<0, 1, 0>, point<0, 0, -1>,
+                 point<0, 0, 1>>;
+
+/**
+ * boundary policies.
+ *
+ * resolve() maps an index which may be outside [0, n_) back into the grid and
+ * returns true, or returns false if the neighbour should read fill() instead.
+ */
+/** out-of-range neighbours read the nearest cell on the edge*/
+struct clamp {
+  bool resolve(std::ptrdiff_t &i_, std::ptrdiff_t n_) const noexcept {
+    i_ = i_ < 0 ? 0 : (i_ >= n_ ? n_ - 1 : i_);
+    return true;
+  }
+  template <typename T>
+  T fill() const {
+    return T();
+  }
+};
+/** out-of-range neighbours read the cell on the opposite edge*/
+struct wrap {
+  bool resolve(std::ptrdiff_t &i_, std::ptrdiff_t n_) const noexcept {
+    i_ %= n_;
+    if (i_ < 0) i_ += n_;
+    return true;
+  }
+  template <typename T>
+  T fill() const {
+    return T();
+  }
+};
+/** out-of-range neighbours read a fixed value*/
+template <typename V>
+struct constant {
+  V value;
+  bool resolve(std::ptrdiff_t &i_, std::ptrdiff_t n_) const noexcept {
+    return i_ >= 0 && i_ < n_;
+  }
+  template <typename T>
+  T fill() const {
+    return T(value);
+  }
+};
+/** helper deducing the type of constant*/
+template <typename V>
+constant<V> make_constant(V value_) {
+  return constant<V>{value_};
+}
+
+/**
+ * tuning parameters of apply.
+ */
+struct config {
+  /** number of worker threads, 0 for std::thread::hardware_concurrency.
+   * every apply call starts and joins its own threads, which can cost more
+   * than a step on a small grid; iterate starts them once for all its steps
+   */
+  unsigned int threads = 0;
+  /** tile length along the contiguous axis, values beyond the axis length
+   * (e.g. the maximum of size_t) leave the axis untiled
+   */
+  std::size_t inner_tile = 1024;
+  /** tile length along every other axis*/
+  std::size_t outer_tile = 16;
+};
+
+namespace detail {
+/** does the actual work of apply, with the geometry of the grid resolved
+ * into runtime tables once
+ */
+template <typename Nbhd, typename T, int... Dims>
+class engine {
+ public:
+  static constexpr std::size_t dimension = sizeof...(Dims);
+  static constexpr std::size_t points = Nbhd::size;
+  using index_type = std::ptrdiff_t;
+  using values_type = std::array<T, points>;
+
+  engine(const T *src_, T *dst_, const config &cfg_) noexcept
+      : src(src_), dst(dst_) {
+    const std::array<index_type, dimension> lens = {{Dims...}};
+    const auto table = Nbhd::table();
+    index_type stride = 1;
+    tiles = 1;
+    for (std::size_t d = 0; d != dimension; ++d) {
+      len[d] = lens[d];
+      lo[d] = -Nbhd::min_offset(d);
+      hi[d] = len[d] - Nbhd::max_offset(d);
+      // clamped to the axis before the cast, any size_t asks for no tiling
+      block[d] = static_cast<index_type>(std::min<std::size_t>(
+          std::max<std::size_t>(1, d == 0 ? cfg_.inner_tile : cfg_.outer_tile),
+          static_cast<std::size_t>(len[d])));
+      tile_count[d] = (len[d] + block[d] - 1) / block[d];
+      tiles *= tile_count[d];
+      strides[d] = stride;
+      for (std::size_t k = 0; k != points; ++k) {
+        off[k][d] = table[k][d];
+        rel[k] += off[k][d] * stride;
+      }
+      stride *= len[d];
+    }
+  }
+
+  index_type tile_number() const noexcept { return tiles; }
+
+  /** update every cell inside tile t_*/
+  template <typename Kernel, typename Policy>
+  void run_tile(index_type t_, Kernel &kernel_, const Policy &policy_) const {
+    std::array<index_type, dimension> first, last, i;
+    for (std::size_t d = 0; d != dimension; ++d) {
+      index_type n = t_ % tile_count[d];
+      t_ /= tile_count[d];
+      first[d] = n * block[d];
+      last[d] = std::min(first[d] + block[d], len[d]);
+    }
+    i = first;
+    while (true) {
+      run_row(i, first[0], last[0], kernel_, policy_);
+      std::size_t d = 1;
+      for (; d < dimension; ++d) {
+        if (++i[d] != last[d]) break;
+        i[d] = first[d];
+      }
+      if (d >= dimension) return;
+    }
+  }
+
+ private:
+  const T *src;
+  T *dst;
+  index_type tiles;
+  std::array<index_type, dimension> len, lo, hi, block, tile_count, strides;
+  std::array<std::array<index_type, dimension>, points> off;
+  std::array<index_type, points> rel{};
+
+  /** update cells [x0_, x1_) of the row passing through i_*/
+  template <typename Kernel, typename Policy>
+  void run_row(std::array<index_type, dimension> &i_, index_type x0_,
+               index_type x1_, Kernel &kernel_, const Policy &policy_) const {
+    bool interior = true;
+    index_type base = 0;
+    for (std::size_t d = 1; d < dimension; ++d) {
+      interior = interior && i_[d] >= lo[d] && i_[d] < hi[d];
+      base += i_[d] * strides[d];
+    }
+    index_type xa = x1_, xb = x1_;
+    if (interior) {
+      xa = std::min(std::max(x0_, lo[0]), x1_);
+      xb = std::max(std::min(x1_, hi[0]), xa);
+    }
+    for (i_[0] = x0_; i_[0] < xa; ++i_[0]) run_cell(i_, kernel_, policy_);
+    run_span(base, xa, xb, kernel_);
+    for (i_[0] = xb; i_[0] < x1_; ++i_[0]) run_cell(i_, kernel_, policy_);
+  }
+  /** the fast path, every neighbour of [xa_, xb_) is inside the grid*/
+  template <typename Kernel>
+  void run_span(index_type base_, index_type xa_, index_type xb_,
+                Kernel &kernel_) const {
+    // the pointers start at xa_, every one of them is then inside the grid
+    if (xa_ >= xb_) return;
+    const T *in[points];
+    for (std::size_t k = 0; k != points; ++k) {
+      in[k] = src + base_ + rel[k] + xa_;
+    }
+    T *out = dst + base_ + xa_;
+    const index_type n = xb_ - xa_;
+    CCS_STENCIL_IVDEP
+    for (index_type x = 0; x < n; ++x) {
+      values_type v;
+      for (std::size_t k = 0; k != points; ++k) v[k] = in[k][x];
+      out[x] = kernel_(static_cast<const values_type &>(v));
+    }
+  }
+  /** the slow path, neighbours are resolved through the boundary policy*/
+  template <typename Kernel, typename Policy>
+  void run_cell(const std::array<index_type, dimension> &i_, Kernel &kernel_,
+                const Policy &policy_) const {
+    values_type v;
+    index_type pos = 0;
+    for (std::size_t k = 0; k != points; ++k) {
+      bool inside = true;
+      index_type at = 0;
+      for (std::size_t d = 0; d != dimension && inside; ++d) {
+        index_type c = i_[d] + off[k][d];
+        inside = policy_.resolve(c, len[d]);
+        at += c * strides[d];
+      }
+      v[k] = inside ? src[at] : policy_.template fill<T>();
+    }
+    for (std::size_t d = 0; d != dimension; ++d) pos += i_[d] * strides[d];
+    dst[pos] = kernel_(static_cast<const values_type &>(v));
+  }
+};
+/** the number of threads to use, never more than there are tiles*/
+inline unsigned int thread_count(const config &cfg_, std::ptrdiff_t tiles_) {
+  unsigned int threads =
+      cfg_.threads ? cfg_.threads : std::thread::hardware_concurrency();
+  return static_cast<unsigned int>(std::max<std::ptrdiff_t>(
+      1, std::min<std::ptrdiff_t>(threads ? threads : 1, tiles_)));
+}
+
+/** run rounds_ rounds of tiles_ tiles on threads_ threads, the calling one
+ * included.
+ *
+ * the threads are started once, a round begins only when every thread has
+ * finished the previous one. each thread works on its own copy of kernel_
+ * and calls run_(round, tile, kernel). the first exception stops the work
+ * and is rethrown once all threads are joined.
+ */
+template <typename Kernel, typename Run>
+void run_rounds(unsigned int threads_, std::size_t rounds_,
+                std::ptrdiff_t tiles_, const Kernel &kernel_, Run run_) {
+  if (threads_ == 1) {
+    Kernel kernel = kernel_;
+    for (std::size_t r = 0; r != rounds_; ++r) {
+      for (std::ptrdiff_t t = 0; t != tiles_; ++t) run_(r, t, kernel);
+    }
+    return;
+  }
+
+  std::atomic<std::ptrdiff_t> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool ready = false;
+  unsigned int members = 1, arrived = 0;
+  std::size_t generation = 0;
+
+  auto fail = [&]() {
+    failed = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error) error = std::current_exception();
+  };
+  // the last thread to arrive hands out the tiles of the next round
+  auto wait_round = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto gen = generation;
+    if (++arrived == members) {
+      arrived = 0;
+      ++generation;
+      next = 0;
+      cv.notify_all();
+    } else {
+      cv.wait(lock, [&]() { return gen != generation; });
+    }
+  };
+  auto worker = [&]() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return ready; });
+    }
+    std::unique_ptr<Kernel> kernel;
+    try {
+      kernel.reset(new Kernel(kernel_));
+    } catch (...) {
+      fail();
+    }
+    // a failed thread keeps meeting the others between rounds, so that
+    // nobody waits for it forever
+    for (std::size_t r = 0; r != rounds_; ++r) {
+      if (r) wait_round();
+      try {
+        for (auto t = next++; t < tiles_ && !failed; t = next++) {
+          run_(r, t, *kernel);
+        }
+      } catch (...) {
+        fail();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  try {
+    pool.reserve(threads_ - 1);
+    for (unsigned int n = 1; n != threads_; ++n) pool.emplace_back(worker);
+  } catch (...) {
+    // no more threads can be started, the tiles are shared by the threads
+    // already running and this one, which all get joined below
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    members = static_cast<unsigned int>(pool.size()) + 1;
+    ready = true;
+  }
+  cv.notify_all();
+  worker();
+  for (auto &th : pool) th.join();
+  if (error) std::rethrow_exception(error);
+}
+}  // namespace detail
+
+/**
+ * apply kernel_ once over the whole grid, reading src_ and writing dst_.
+ *
+ * the grid is split into tiles which are shared by the worker threads, cells
+ * whose neighbours are all inside the grid take a branch-free path along the
+ * contiguous axis. src_ and dst_ must not share storage.
+ * @param Nbhd the neighborhood type
+ * @param kernel_ callable object taking const std::array<T, Nbhd::size>&,
+ * returns the new value of the cell; it is called concurrently
+ * @param policy_ boundary policy, clamp, wrap or constant
+ * @excepion std::invalid_argument
+ * @excepion whatever kernel_ throws, rethrown in the calling thread
+ */
+template <typename Nbhd, typename T, int... Dims, typename Kernel,
+          typename Policy>
+void apply(const Darray_base<T, Dims...> &src_, Darray_base<T, Dims...> &dst_,
+           Kernel kernel_, const Policy &policy_, const config &cfg_ = {}) {
+  static_assert(Nbhd::dimension == sizeof...(Dims),
+                "ERROR: neighborhood does not match the array dimension");
+  const T *src = &*src_.cbegin();
+  T *dst = &*dst_.begin();
+  if (src == dst) {
+    throw std::invalid_argument("ERROR: stencil source aliases destination");
+  }
+  const detail::engine<Nbhd, T, Dims...> eng(src, dst, cfg_);
+  detail::run_rounds(
+      detail::thread_count(cfg_, eng.tile_number()), 1, eng.tile_number(),
+      kernel_, [&](std::size_t, std::ptrdiff_t t_, Kernel &k_) {
+        eng.run_tile(t_, k_, policy_);
+      });
+}
+
+/**
+ * apply kernel_ steps_ times, double buffering between cur_ and tmp_.
+ *
+ * the worker threads are started once for all the steps and wait for each
+ * other between two steps, so a step costs no thread start-up. the result is
+ * left in cur_ and tmp_ holds the previous generation, as if the two arrays
+ * were swapped after every step. if kernel_ throws, the remaining steps are
+ * skipped and both arrays hold unspecified values.
+ * @see apply
+ */
+template <typename Nbhd, typename T, int... Dims, typename Kernel,
+          typename Policy>
+void iterate(Darray<T, Dims...> &cur_, Darray<T, Dims...> &tmp_,
+             std::size_t steps_, Kernel kernel_, const Policy &policy_,
+             const config &cfg_ = {}) {
+  static_assert(Nbhd::dimension == sizeof...(Dims),
+                "ERROR: neighborhood does not match the array dimension");
+  if (steps_ == 0) return;
+  T *a = &*cur_.begin();
+  T *b = &*tmp_.begin();
+  if (a == b) {
+    throw std::invalid_argument("ERROR: stencil source aliases destination");
+  }
+  const detail::engine<Nbhd, T, Dims...> forth(a, b, cfg_), back(b, a, cfg_);
+  detail::run_rounds(
+      detail::thread_count(cfg_, forth.tile_number()), steps_,
+      forth.tile_number(), kernel_,
+      [&](std::size_t step_, std::ptrdiff_t t_, Kernel &k_) {
+        (step_ % 2 ? back : forth).run_tile(t_, k_, policy_);
+      });
+  if (steps_ % 2) cur_.swap(tmp_);
+}
+}  // namespace stencil
+}  // namespace ccs
+
+#undef CCS_STENCIL_IVDEP
+
+#endif
@@ -0,0 +1,200 @@
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include "Darray.hpp"
+#include "stencil.hpp"
+
+namespace st = ccs::stencil;
+
+/** an asymmetric 3D neighborhood, so that a mixed-up offset shows up*/
+using skew_3d = st::neighborhood<st::point<0, 0, 0>, st::point<-2, 0, 0>,
+                                 st::point<1, 0, 0>, st::point<0, -1, 1>,
+                                 st::point<0, 2, 0>, st::point<1, 0, -1>>;
+const int skew_3d_table[6][3] = {{0, 0, 0},  {-2, 0, 0}, {1, 0, 0},
+                                 {0, -1, 1}, {0, 2, 0},  {1, 0, -1}};
+
+/** weights every neighbour differently*/
+template <std::size_t N>
+double weigh(const std::array<double, N> &v) {
+  double ans = 0;
+  for (std::size_t k = 0; k != N; ++k) ans += (k + 1.5) * v[k];
+  return ans;
+}
+
+/** the naive loop, reads every neighbour through at()*/
+template <typename Policy>
+double naive_3d(const ccs::Darray<double, 13, 7, 5> &a_, int x_, int y_,
+                int z_, const Policy &p_) {
+  const std::ptrdiff_t len[3] = {13, 7, 5};
+  std::array<double, 6> v;
+  for (int k = 0; k != 6; ++k) {
+    std::ptrdiff_t c[3] = {x_ + skew_3d_table[k][0], y_ + skew_3d_table[k][1],
+                           z_ + skew_3d_table[k][2]};
+    bool inside = true;
+    for (int d = 0; d != 3 && inside; ++d) inside = p_.resolve(c[d], len[d]);
+    v[k] = inside ? a_.at(int(c[0]), int(c[1]), int(c[2]))
+                  : p_.template fill<double>();
+  }
+  return weigh(v);
+}
+
+template <typename Policy>
+void test_3d(const Policy &p_) {
+  ccs::Darray<double, 13, 7, 5> a([](std::size_t i) { return i * 0.25 - 7; });
+  for (unsigned int threads : {1u, 3u, 4u}) {
+    const std::size_t huge = std::numeric_limits<std::size_t>::max();
+    for (std::size_t inner : {std::size_t(1), std::size_t(4), std::size_t(5),
+                              std::size_t(1024), huge}) {
+      for (std::size_t outer : {std::size_t(1), std::size_t(2),
+                                std::size_t(3), std::size_t(16), huge}) {
+        st::config cfg;
+        cfg.threads = threads;
+        cfg.inner_tile = inner;
+        cfg.outer_tile = outer;
+        ccs::Darray<double, 13, 7, 5> b(ccs::for_overwrite);
+        st::apply<skew_3d>(a, b, weigh<6>, p_, cfg);
+        for (int z = 0; z != 5; ++z) {
+          for (int y = 0; y != 7; ++y) {
+            for (int x = 0; x != 13; ++x) {
+              assert(b.at(x, y, z) == naive_3d(a, x, y, z, p_));
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void test_2d() {
+  ccs::Darray<double, 9, 6> a([](std::size_t i) { return double(i % 7); });
+  st::config cfg;
+  cfg.threads = 3;
+  cfg.inner_tile = 4;
+  cfg.outer_tile = 4;
+  ccs::Darray<double, 9, 6> b(ccs::for_overwrite);
+  st::apply<st::cross_2d>(a, b, weigh<5>, st::make_constant(-1.0), cfg);
+  const int off[5][2] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for (int y = 0; y != 6; ++y) {
+    for (int x = 0; x != 9; ++x) {
+      std::array<double, 5> v;
+      for (int k = 0; k != 5; ++k) {
+        int cx = x + off[k][0], cy = y + off[k][1];
+        bool inside = cx >= 0 && cx < 9 && cy >= 0 && cy < 6;
+        v[k] = inside ? a.at(cx, cy) : -1.0;
+      }
+      assert(b.at(x, y) == weigh(v));
+    }
+  }
+}
+
+void test_1d() {
+  ccs::Darray<int, 100> a([](std::size_t i) { return int(i); });
+  ccs::Darray<int, 100> b(ccs::for_overwrite);
+  st::config cfg;
+  cfg.threads = 4;
+  cfg.inner_tile = 7;
+  auto sum = [](const std::array<int, 2> &v) { return v[0] + v[1]; };
+  using ends = st::neighborhood<st::point<-2>, st::point<3>>;
+  st::apply<ends>(a, b, sum, st::wrap(), cfg);
+  for (int x = 0; x != 100; ++x) {
+    assert(b[x] == (x + 98) % 100 + (x + 3) % 100);
+  }
+  st::apply<ends>(a, b, sum, st::clamp(), cfg);
+  assert(b[0] == 0 + 3 && b[50] == 48 + 53 && b[99] == 97 + 99);
+}
+
+void test_iterate() {
+  auto step = [](const std::array<double, 7> &v) {
+    return v[0] + 0.1 * (v[1] + v[2] + v[3] + v[4] + v[5] + v[6] - 6 * v[0]);
+  };
+  ccs::Darray<double, 6, 5, 4> cur([](std::size_t i) { return i * 1.0; });
+  ccs::Darray<double, 6, 5, 4> tmp(ccs::for_overwrite);
+  ccs::Darray<double, 6, 5, 4> ref(cur), ref_tmp(ccs::for_overwrite);
+  st::config cfg;
+  cfg.threads = 3;
+  cfg.outer_tile = 2;
+  st::iterate<st::cross_3d>(cur, tmp, 3, step, st::clamp(), cfg);
+  st::apply<st::cross_3d>(ref, ref_tmp, step, st::clamp());
+  st::apply<st::cross_3d>(ref_tmp, ref, step, st::clamp());
+  st::apply<st::cross_3d>(ref, ref_tmp, step, st::clamp());
+  for (std::size_t i = 0; i != cur.size(); ++i) assert(cur[i] == ref_tmp[i]);
+  // an even number of steps, the result stays in the same storage
+  cfg.threads = 4;
+  st::iterate<st::cross_3d>(cur, tmp, 2, step, st::clamp(), cfg);
+  st::apply<st::cross_3d>(ref_tmp, ref, step, st::clamp());
+  st::apply<st::cross_3d>(ref, ref_tmp, step, st::clamp());
+  for (std::size_t i = 0; i != cur.size(); ++i) assert(cur[i] == ref_tmp[i]);
+  // a throw in a later step stops every thread and reaches the caller
+  std::atomic<int> calls(0);
+  cfg.outer_tile = 1;
+  try {
+    st::iterate<st::cross_3d>(cur, tmp, 5,
+                              [&](const std::array<double, 7> &v) {
+                                if (++calls == 300) throw std::range_error("");
+                                return v[0];
+                              },
+                              st::clamp(), cfg);
+    assert(false);
+  } catch (std::range_error &) {
+  }
+  assert(calls < 5 * 6 * 5 * 4);
+}
+
+/** a kernel whose copies throw once copies reach fail_at*/
+struct copy_thrower {
+  static std::atomic<int> copies;
+  static int fail_at;
+  copy_thrower() {}
+  copy_thrower(const copy_thrower &) {
+    if (++copies >= fail_at) throw std::bad_alloc();
+  }
+  double operator()(const std::array<double, 5> &v) const { return v[0]; }
+};
+std::atomic<int> copy_thrower::copies;
+int copy_thrower::fail_at;
+
+void test_errors() {
+  ccs::Darray<double, 8, 8> a(1.0), b(ccs::for_overwrite);
+  st::config cfg;
+  cfg.threads = 4;
+  cfg.outer_tile = 1;
+  try {
+    st::apply<st::cross_2d>(a, b,
+                            [](const std::array<double, 5> &) -> double {
+                              throw std::runtime_error("kernel");
+                            },
+                            st::clamp(), cfg);
+    assert(false);
+  } catch (std::runtime_error &) {
+  }
+  // the first worker copies the kernel, the others fail to
+  copy_thrower::copies = 0;
+  copy_thrower::fail_at = 2;
+  try {
+    st::apply<st::cross_2d>(a, b, copy_thrower(), st::clamp(), cfg);
+    assert(false);
+  } catch (std::bad_alloc &) {
+  }
+  try {
+    st::apply<st::cross_2d>(a, a, weigh<5>, st::clamp());
+    assert(false);
+  } catch (std::invalid_argument &) {
+  }
+}
+
+int main() {
+  test_3d(st::clamp());
+  test_3d(st::wrap());
+  test_3d(st::make_constant(0.5));
+  test_2d();
+  test_1d();
+  test_iterate();
+  test_errors();
+  std::cout << "stencil tests passed" << std::endl;
+  return 0;
+}
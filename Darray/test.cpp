@@ -1,13 +1,129 @@
+#include <array>
+#include <cassert>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 #include "Darray.hpp"
-#include "winsock.h"
 
 class a {
  public:
   using A = int;
 };
+
+/** counts how its objects are constructed*/
+struct Cnt {
+  static int defaults, copies, moves;
+  std::string s;
+  Cnt() { ++defaults; }
+  Cnt(const char *s_) : s(s_) {}
+  Cnt(const Cnt &c) : s(c.s) { ++copies; }
+  Cnt(Cnt &&c) : s(std::move(c.s)) { ++moves; }
+  static void reset() { defaults = copies = moves = 0; }
+};
+int Cnt::defaults, Cnt::copies, Cnt::moves;
+
+/** throws on the construction numbered fail_at, counts live objects*/
+struct Thrower {
+  static int live, built, fail_at;
+  Thrower() { check(); }
+  Thrower(int) { check(); }
+  Thrower(const Thrower &) { check(); }
+  ~Thrower() { --live; }
+  static void check() {
+    if (++built == fail_at) throw std::runtime_error("Thrower");
+    ++live;
+  }
+};
+int Thrower::live, Thrower::built, Thrower::fail_at;
+
+void test_construction() {
+  // range, forward iterators, short range padded with value-initialized
+  std::vector<int> v = {1, 2, 3};
+  ccs::Darray<int, 2, 3> r(v.begin(), v.end());
+  assert(r[0] == 1 && r[2] == 3 && r[3] == 0 && r[5] == 0);
+  // range, input iterators
+  std::istringstream is("4 5 6");
+  ccs::Darray<int, 2, 3> ri((std::istream_iterator<int>(is)),
+                            std::istream_iterator<int>());
+  assert(ri[0] == 4 && ri[2] == 6 && ri[5] == 0);
+  // too long ranges
+  std::vector<int> big(7);
+  try {
+    ccs::Darray<int, 2, 3> b(big.begin(), big.end());
+    assert(false);
+  } catch (std::length_error &) {
+  }
+  std::istringstream is2("1 2 3 4 5 6 7");
+  try {
+    ccs::Darray<int, 2, 3> b((std::istream_iterator<int>(is2)),
+                             std::istream_iterator<int>());
+    assert(false);
+  } catch (std::length_error &) {
+  }
+  // initializer list pads with value-initialized elements
+  ccs::Darray<std::string, 2, 2> s = {"x", "y"};
+  assert(s[1] == "y" && s[3].empty());
+  // fill and generator
+  ccs::Darray<int, 2, 3> f(7);
+  for (auto x : f) assert(x == 7);
+  ccs::Darray<int, 2, 3> g([](std::size_t i) { return int(i * 2); });
+  assert(g[0] == 0 && g[5] == 10);
+  // a captureless lambda converts to bool, it must still be a generator
+  ccs::Darray<bool, 4> gb([](std::size_t i) { return i % 2 == 1; });
+  assert(!gb[0] && gb[1] && !gb[2] && gb[3]);
+  ccs::Darray<bool, 4> fb(true);
+  assert(fb[0] && fb[3]);
+  // for_overwrite and the default constructor construct every element once
+  Cnt::reset();
+  ccs::Darray<Cnt, 3> o(ccs::for_overwrite);
+  ccs::Darray<Cnt, 3> d;
+  assert(Cnt::defaults == 6 && Cnt::copies == 0 && Cnt::moves == 0);
+  ccs::Darray<int, 2, 3> w(ccs::for_overwrite);
+  for (auto &x : w) x = 1;
+  assert(w[5] == 1);
+  // one move per element from an rvalue std::array
+  std::array<Cnt, 3> src = {{"a", "b", "c"}};
+  Cnt::reset();
+  ccs::Darray<Cnt, 3> m(std::move(src));
+  assert(Cnt::moves == 3 && Cnt::copies == 0 && Cnt::defaults == 0);
+  assert(m[2].s == "c");
+  // one copy per element from a copy
+  Cnt::reset();
+  ccs::Darray<Cnt, 3> c(m);
+  assert(Cnt::copies == 3 && Cnt::moves == 0 && Cnt::defaults == 0);
+  // rollback when an element constructor throws
+  Thrower::live = Thrower::built = 0;
+  Thrower::fail_at = 4;
+  try {
+    ccs::Darray<Thrower, 6> t;
+    assert(false);
+  } catch (std::runtime_error &) {
+  }
+  assert(Thrower::live == 0);
+  Thrower::built = 0;
+  Thrower::fail_at = 5;
+  std::vector<int> three(3);
+  try {
+    ccs::Darray<Thrower, 6> t(three.begin(), three.end());
+    assert(false);
+  } catch (std::runtime_error &) {
+  }
+  assert(Thrower::live == 0);
+  Thrower::fail_at = 0;
+  // destroying a moved-from Darray
+  {
+    ccs::Darray<std::string, 2, 2> from = {"p", "q"};
+    ccs::Darray<std::string, 2, 2> to(std::move(from));
+    assert(to[1] == "q");
+  }
+}
+
 int main() {
+  test_construction();
   ccs::Darray<int, 3, 3, 3> arr = {1, 2,  3,  4,  5,  6,  7, 8,
                                    9, 10, 11, 12, 13, 14, 15};
   ccs::Darray<int, 3, 3, 3> arr2 = {1, 2,  3,  4,  5,  6,  7,  8,